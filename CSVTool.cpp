@@ -8,7 +8,7 @@ namespace {
 const char* HELP =
     "\n"
     "                    CSV TOOL\n"
-    "Load and query tables of numerical data from CSV files.\n"
+    "Load and query tables of numerical and text data from CSV files.\n"
     "The numerical data is zero-indexed, excluding the column headers.\n"
     "Commands are case-insensitive and are executed sequentially.\n"
     "\n"
@@ -18,6 +18,9 @@ const char* HELP =
     "These are all available operations:\n"
     "  READCSV         - Read in CSV data from file\n"
     "                    readcsv-[filename.csv]\n"
+    "                    Several files with matching headers are loaded into\n"
+    "                    one table from a list or a wildcard pattern.\n"
+    "                    readcsv-[a.csv,b.csv] or readcsv-[part-*.csv]\n"
     "  PRINTTABLE      - Prints the table headers and data.\n"
     "                    printtable\n"
     "  PRINTHEADERS    - Prints the table headers.\n"
@@ -56,6 +59,30 @@ const char* HELP =
     "                    dividecolumns-#-#\n"
     "  MULTIPLYCOLUMNS - Multiply two columns and append the result to table.\n"
     "                    multiplycolumns-#-#\n"
+    "  ROLLINGAVG      - Append the average over a trailing window of # rows.\n"
+    "                    rollingavg-[column #]-[window #]\n"
+    "  ROLLINGSUM      - Append the sum over a trailing window of # rows.\n"
+    "                    rollingsum-[column #]-[window #]\n"
+    "  ROLLINGMIN      - Append the minimum over a trailing window of # rows.\n"
+    "                    rollingmin-[column #]-[window #]\n"
+    "  ROLLINGMAX      - Append the maximum over a trailing window of # rows.\n"
+    "                    rollingmax-[column #]-[window #]\n"
+    "  WATCH           - Keeps a column statistic updated as rows are added.\n"
+    "                    watch-[min|max|average|count|median]-#\n"
+    "  REFRESH         - Reads rows appended to the CSV file, prints watches.\n"
+    "                    refresh\n"
+    "  FOLLOW          - Refreshes every # seconds (default 1) until killed.\n"
+    "                    follow-#\n"
+    "  SCHEMA          - Sets column types, for loaded and later CSV files.\n"
+    "                    schema-[column name]=[int64|float32|float64|string]\n"
+    "  PRINTSCHEMA     - Prints the type of each column.\n"
+    "                    printschema\n"
+    "  DISTINCTCOUNT   - Prints an estimate of the distinct values in a column.\n"
+    "                    distinctcount-#\n"
+    "  APPROXIMATE     - Turns approximate medians and sampling on or off.\n"
+    "                    approximate-[on|off]\n"
+    "  SAMPLE          - Percent of rows read by approximate averages/medians.\n"
+    "                    sample-#\n"
     "  QUIT            - Exits the program.\n"
     "                    quit\n"
     "\n\n";
@@ -0,0 +1,303 @@
+#include "Column.h"
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <sstream>
+
+
+namespace { // Anonymous namespace for helper functions.
+// True if only whitespace follows end, ie. a trailing '\r' or space.
+bool onlySpaceLeft(const char* end) {
+    while (*end == ' ' || *end == '\t' || *end == '\r') end++;
+    return *end == '\0';
+}
+
+// Strict number parsing: the whole cell must be the number.
+bool parseInt64(const std::string& text, int64_t& val) {
+    const char* start = text.c_str();
+    char* end;
+    errno = 0;
+    long long parsed = std::strtoll(start, &end, 10);
+    if (end == start || errno == ERANGE || !onlySpaceLeft(end)) return false;
+    val = parsed;
+    return true;
+}
+
+bool parseFloat(const std::string& text, float& val) {
+    const char* start = text.c_str();
+    char* end;
+    val = std::strtof(start, &end);
+    return end != start && onlySpaceLeft(end);
+}
+
+bool parseDouble(const std::string& text, double& val) {
+    const char* start = text.c_str();
+    char* end;
+    val = std::strtod(start, &end);
+    return end != start && onlySpaceLeft(end);
+}
+
+// True for a number written with leading zeros, ie. 007 or -02134, which
+// is more likely a code than a quantity. 0 and 0.5 are not zero padded.
+bool zeroPadded(const std::string& text) {
+    unsigned int i = (text[0] == '-' || text[0] == '+') ? 1 : 0;
+    return i + 1 < text.size() && text[i] == '0' && std::isdigit(text[i + 1]);
+}
+
+uint32_t intern(Column& col, const std::string& text) {
+    auto found = col.lookup.find(text);
+    if (found != col.lookup.end()) return found->second;
+    uint32_t code = col.dictionary.size();
+    col.dictionary.push_back(text);
+    col.lookup[text] = code;
+    return code;
+}
+
+unsigned int cellCount(const Column& col) {
+    switch (col.type) {
+        case(INT64):   return col.i64.size();
+        case(FLOAT32): return col.f32.size();
+        case(FLOAT64): return col.f64.size();
+        case(STRING):  return col.codes.size();
+    }
+    return 0;
+}
+
+template <typename T>
+void appendTyped(Column& dst, const Column& src) {
+    std::vector<T>& to = CellTraits<T>::cells(dst);
+    const std::vector<T>& from = CellTraits<T>::cells(src);
+    to.insert(to.end(), from.begin(), from.end());
+}
+} // namespace
+
+
+std::string typeName(const ColumnType type) {
+    switch (type) {
+        case(INT64):   return "int64";
+        case(FLOAT32): return "float32";
+        case(FLOAT64): return "float64";
+        case(STRING):  return "string";
+    }
+    return "";
+}
+
+
+bool parseType(const std::string& name, ColumnType& type) {
+    std::string lower(name);
+    for (auto& ch : lower) ch = std::tolower(ch);
+    if (lower == "int64") type = INT64;
+    else if (lower == "float32") type = FLOAT32;
+    else if (lower == "float64") type = FLOAT64;
+    else if (lower == "string") type = STRING;
+    else return false;
+    return true;
+}
+
+
+bool isNumeric(const Column& col) {
+    return col.type != STRING;
+}
+
+
+void pushNull(Column& col, const unsigned int rows) {
+    pushBit(col.valid, rows, false);
+    switch (col.type) {
+        case(INT64):   col.i64.push_back(0); break;
+        case(FLOAT32): col.f32.push_back(NAN); break;
+        case(FLOAT64): col.f64.push_back(NAN); break;
+        case(STRING):  col.codes.push_back(0); break;
+    }
+}
+
+
+// Appends a number, widening an INT64 column if val is not a whole number.
+void pushValue(Column& col, const unsigned int rows, const double val) {
+    if (col.type == INT64 && !(std::trunc(val) == val &&
+                               std::fabs(val) < 9.2e18)) // Fits in int64_t.
+        convertColumn(col, FLOAT64);
+    switch (col.type) {
+        case(INT64):   col.i64.push_back(int64_t(val)); break;
+        case(FLOAT32): col.f32.push_back(val); break;
+        case(FLOAT64): col.f64.push_back(val); break;
+        case(STRING): {
+            std::ostringstream ss;
+            ss.precision(std::numeric_limits<double>::digits10);
+            ss << val;
+            col.codes.push_back(intern(col, ss.str()));
+            break;
+        }
+    }
+    pushBit(col.valid, rows, true);
+}
+
+
+// Parses text as a cell of the column's type. If it does not fit, the
+// column is first widened: INT64 to FLOAT64, and any number type to STRING.
+void pushText(Column& col, const unsigned int rows, const std::string& text) {
+    if (text.empty()) return pushNull(col, rows);
+    int64_t i;
+    float f;
+    double d;
+    if (col.type == INT64 && !parseInt64(text, i))
+        convertColumn(col, parseDouble(text, d) ? FLOAT64 : STRING);
+    else if (col.type == FLOAT32 && !parseFloat(text, f))
+        convertColumn(col, STRING);
+    else if (col.type == FLOAT64 && !parseDouble(text, d))
+        convertColumn(col, STRING);
+
+    switch (col.type) {
+        case(INT64):   col.i64.push_back(i); break;
+        case(FLOAT32): col.f32.push_back(f); break;
+        case(FLOAT64): col.f64.push_back(d); break;
+        case(STRING):  col.codes.push_back(intern(col, text)); break;
+    }
+    pushBit(col.valid, rows, true);
+}
+
+
+// The narrowest type no narrower than type that can hold the text. Zero
+// padded numbers are STRING, as a number type would drop their zeros.
+ColumnType classifyText(const std::string& text, const ColumnType type) {
+    int64_t i;
+    float f;
+    double d;
+    if (zeroPadded(text)) return STRING;
+    switch (type) {
+        case(INT64):
+            if (parseInt64(text, i)) return INT64;
+            return parseDouble(text, d) ? FLOAT64 : STRING;
+        case(FLOAT32):
+            return parseFloat(text, f) ? FLOAT32 : STRING;
+        case(FLOAT64):
+            return parseDouble(text, d) ? FLOAT64 : STRING;
+        case(STRING):
+            return STRING;
+    }
+    return STRING;
+}
+
+
+void copyCell(Column& dst, const unsigned int dst_rows,
+              const Column& src, const unsigned int src_row) {
+    if (!testBit(src.valid, src_row)) return pushNull(dst, dst_rows);
+    if (src.type == STRING || dst.type == STRING)
+        return pushText(dst, dst_rows, cellText(src, src_row));
+    if (src.type != dst.type)
+        return pushValue(dst, dst_rows, cellValue(src, src_row));
+    switch (src.type) {
+        case(INT64):   dst.i64.push_back(src.i64[src_row]); break;
+        case(FLOAT32): dst.f32.push_back(src.f32[src_row]); break;
+        case(FLOAT64): dst.f64.push_back(src.f64[src_row]); break;
+        case(STRING):  break; // Handled above.
+    }
+    pushBit(dst.valid, dst_rows, true);
+}
+
+
+// Removes a row from the column, shifting the bits of later rows down.
+void eraseCell(Column& col, const unsigned int rows, const unsigned int row) {
+    std::vector<uint64_t>& bits = col.valid;
+    unsigned int w = row / WORD_BITS, b = row % WORD_BITS;
+    uint64_t low = bits[w] & ((uint64_t(1) << b) - 1);
+    uint64_t high = (b == WORD_BITS - 1) ? 0 : (bits[w] >> (b + 1)) << b;
+    bits[w] = low | high;
+    for (unsigned int k = w; k + 1 < bits.size(); k++) {
+        bits[k] |= bits[k + 1] << (WORD_BITS - 1);
+        bits[k + 1] >>= 1;
+    }
+    if ((rows - 1) % WORD_BITS == 0) bits.pop_back();
+    switch (col.type) {
+        case(INT64):   col.i64.erase(col.i64.begin() + row); break;
+        case(FLOAT32): col.f32.erase(col.f32.begin() + row); break;
+        case(FLOAT64): col.f64.erase(col.f64.begin() + row); break;
+        case(STRING):  col.codes.erase(col.codes.begin() + row); break;
+    }
+}
+
+
+// Appends all cells of src, which holds src_rows cells, to dst, which holds
+// dst_rows. Both are first widened to a common type if they differ. Bitmap
+// words are copied whole, shifted if dst ends mid-word.
+void appendCells(Column& dst, const unsigned int dst_rows,
+                 Column& src, const unsigned int src_rows) {
+    if (dst.type != src.type) {
+        ColumnType common = (dst.type == STRING || src.type == STRING) ?
+                            STRING : FLOAT64;
+        convertColumn(dst, common);
+        convertColumn(src, common);
+    }
+    switch (src.type) {
+        case(INT64):   appendTyped<int64_t>(dst, src); break;
+        case(FLOAT32): appendTyped<float>(dst, src); break;
+        case(FLOAT64): appendTyped<double>(dst, src); break;
+        case(STRING): {
+            // Dictionaries differ, so translate each code once.
+            std::vector<uint32_t> code_map(src.dictionary.size());
+            for (unsigned int i = 0; i < src.dictionary.size(); i++)
+                code_map[i] = intern(dst, src.dictionary[i]);
+            for (const auto code : src.codes)
+                dst.codes.push_back(code_map.empty() ? 0 : code_map[code]);
+            break;
+        }
+    }
+
+    unsigned int shift = dst_rows % WORD_BITS;
+    if (shift == 0) {
+        dst.valid.insert(dst.valid.end(), src.valid.begin(), src.valid.end());
+        return;
+    }
+    for (const auto bits : src.valid) {
+        dst.valid.back() |= bits << shift;
+        dst.valid.push_back(bits >> (WORD_BITS - shift));
+    }
+    // The last word pushed may lie wholly past the end; it is all zero.
+    dst.valid.resize(numWords(dst_rows + src_rows));
+}
+
+
+// Converts every cell of the column to a new type. Used for widening while
+// parsing and for SCHEMA. If some cell does not fit, ie. 1.5 or abc when
+// asked for INT64, the column is left unchanged and false is returned.
+bool convertColumn(Column& col, const ColumnType type) {
+    if (col.type == type) return true;
+    Column out;
+    out.type = type;
+    unsigned int rows = cellCount(col);
+    for (unsigned int row = 0; row < rows; row++) copyCell(out, row, col, row);
+    // Cells that did not fit widened out, and may have lost their text.
+    if (out.type != type) return false;
+    col = std::move(out);
+    return true;
+}
+
+
+// Text of a non-null cell, to as many digits as the type holds reliably.
+std::string cellText(const Column& col, const unsigned int row) {
+    std::ostringstream ss;
+    switch (col.type) {
+        case(INT64):   ss << col.i64[row]; break;
+        case(FLOAT32):
+            ss.precision(std::numeric_limits<float>::digits10);
+            ss << col.f32[row];
+            break;
+        case(FLOAT64):
+            ss.precision(std::numeric_limits<double>::digits10);
+            ss << col.f64[row];
+            break;
+        case(STRING):  return col.dictionary[col.codes[row]];
+    }
+    return ss.str();
+}
+
+
+// Numeric value of a cell, NaN for STRING columns.
+double cellValue(const Column& col, const unsigned int row) {
+    switch (col.type) {
+        case(INT64):   return col.i64[row];
+        case(FLOAT32): return col.f32[row];
+        case(FLOAT64): return col.f64[row];
+        case(STRING):  return NAN;
+    }
+    return NAN;
+}
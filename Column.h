@@ -0,0 +1,264 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// Storage types a column can hold. Integers and decimals are inferred from
+// the CSV file; FLOAT32 is only used when asked for with SCHEMA. Any text
+// that is not a number makes the column STRING.
+enum ColumnType {
+    INT64,
+    FLOAT32,
+    FLOAT64,
+    STRING,
+};
+
+std::string typeName(const ColumnType type);
+bool parseType(const std::string& name, ColumnType& type);
+
+// A single column of table data. Only the cell vector matching type is
+// used; STRING cells are codes into dictionary, so each distinct string is
+// stored once. Bit (row % 64) of valid[row / 64] is set when the cell holds
+// a value. Null cells are stored as NaN in float columns and as 0 otherwise,
+// so unmasked arithmetic over the whole buffer is harmless; what such cells
+// hold afterwards is never read without checking valid.
+struct Column {
+    ColumnType type = FLOAT64;
+    std::vector<int64_t> i64;
+    std::vector<float> f32;
+    std::vector<double> f64;
+    std::vector<uint32_t> codes;
+    std::vector<std::string> dictionary;
+    std::unordered_map<std::string, uint32_t> lookup; // Inverse of dictionary.
+    std::vector<uint64_t> valid;
+};
+
+// Compile-time mapping from a cell type to its vector in a Column.
+template <typename T> struct CellTraits;
+template <> struct CellTraits<int64_t> {
+    static const ColumnType type = INT64;
+    static std::vector<int64_t>& cells(Column& c) { return c.i64; }
+    static const std::vector<int64_t>& cells(const Column& c) { return c.i64; }
+};
+template <> struct CellTraits<float> {
+    static const ColumnType type = FLOAT32;
+    static std::vector<float>& cells(Column& c) { return c.f32; }
+    static const std::vector<float>& cells(const Column& c) { return c.f32; }
+};
+template <> struct CellTraits<double> {
+    static const ColumnType type = FLOAT64;
+    static std::vector<double>& cells(Column& c) { return c.f64; }
+    static const std::vector<double>& cells(const Column& c) { return c.f64; }
+};
+
+// Result type of arithmetic between two cell types: integers stay exact
+// unless a result overflows, two FLOAT32 columns stay single precision and
+// anything else is FLOAT64.
+template <typename A, typename B> struct Promote { typedef double type; };
+template <> struct Promote<int64_t, int64_t> { typedef int64_t type; };
+template <> struct Promote<float, float> { typedef float type; };
+
+
+// Validity bitmap helpers.
+const unsigned int WORD_BITS = 64;
+const uint64_t ALL_VALID = ~uint64_t(0);
+
+inline unsigned int numWords(unsigned int rows) {
+    return (rows + WORD_BITS - 1) / WORD_BITS;
+}
+
+inline bool testBit(const std::vector<uint64_t>& bits, unsigned int row) {
+    return (bits[row / WORD_BITS] >> (row % WORD_BITS)) & 1;
+}
+
+inline void pushBit(std::vector<uint64_t>& bits, unsigned int rows,
+                    const bool is_valid) {
+    if (rows % WORD_BITS == 0) bits.push_back(0);
+    if (is_valid) bits[rows / WORD_BITS] |= uint64_t(1) << (rows % WORD_BITS);
+}
+
+
+// Cell level operations. rows is the number of cells the column holds.
+bool isNumeric(const Column& col);
+void pushNull(Column& col, const unsigned int rows);
+void pushValue(Column& col, const unsigned int rows, const double val);
+void pushText(Column& col, const unsigned int rows, const std::string& text);
+void copyCell(Column& dst, const unsigned int dst_rows,
+              const Column& src, const unsigned int src_row);
+void eraseCell(Column& col, const unsigned int rows, const unsigned int row);
+void appendCells(Column& dst, const unsigned int dst_rows,
+                 Column& src, const unsigned int src_rows);
+bool convertColumn(Column& col, const ColumnType type);
+ColumnType classifyText(const std::string& text, const ColumnType type);
+std::string cellText(const Column& col, const unsigned int row);
+double cellValue(const Column& col, const unsigned int row);
+
+
+// Calls f with the cell vector of a numeric column. Kernels written as
+// functors with a templated call operator are compiled once per cell type,
+// so the type switch happens once per column rather than once per cell.
+template <typename F>
+void visitNumeric(const Column& col, F& f) {
+    switch (col.type) {
+        case(INT64):   f(col.i64); break;
+        case(FLOAT32): f(col.f32); break;
+        case(FLOAT64): f(col.f64); break;
+        case(STRING):  break;
+    }
+}
+
+// Folds op over the valid cells a bitmap word at a time. Null cells are
+// replaced by identity instead of branched around, so the inner loops are
+// straight-line and all-valid words skip the mask.
+template <typename T, typename Acc, typename Op>
+Acc maskedReduce(const std::vector<T>& cells, const std::vector<uint64_t>& valid,
+                 Acc acc, const T identity, Op op) {
+    const T* vals = cells.data();
+    for (unsigned int w = 0; w < valid.size(); w++) {
+        const uint64_t bits = valid[w];
+        const T* v = vals + w * WORD_BITS;
+        if (bits == 0) continue; // All-null word.
+        if (bits == ALL_VALID) {
+            for (unsigned int i = 0; i < WORD_BITS; i++) acc = op(acc, v[i]);
+        } else {
+            // Tail bits past the last row are always clear.
+            unsigned int n = std::min<size_t>(WORD_BITS,
+                                              cells.size() - w * WORD_BITS);
+            for (unsigned int i = 0; i < n; i++)
+                acc = op(acc, ((bits >> i) & 1) ? v[i] : identity);
+        }
+    }
+    return acc;
+}
+
+// Largest and smallest representable values, infinite where possible.
+template <typename T> T highest() {
+    return std::numeric_limits<T>::has_infinity ?
+        std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+}
+template <typename T> T lowest() {
+    return std::numeric_limits<T>::has_infinity ?
+        -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+}
+
+// Fills cells with op over a and b as their promoted type P. Returns false
+// if a valid result overflowed, which only integer cells can do.
+template <typename P, typename A, typename B, typename R, typename Op>
+bool applyCells(const std::vector<A>& a, const std::vector<B>& b,
+                const std::vector<uint64_t>&, std::vector<R>& cells, Op op) {
+    for (unsigned int i = 0; i < a.size(); i++)
+        cells[i] = op(P(a[i]), P(b[i]));
+    return true;
+}
+
+// Signed integer overflow is undefined, so integer kernels compute through
+// op.overflows() instead. Its flags are gathered a bitmap word at a time and
+// masked, since null cells may overflow harmlessly.
+template <typename P, typename Op>
+bool applyCells(const std::vector<int64_t>& a, const std::vector<int64_t>& b,
+                const std::vector<uint64_t>& valid, std::vector<int64_t>& cells,
+                Op op) {
+    uint64_t overflowed = 0;
+    for (unsigned int w = 0; w < valid.size(); w++) {
+        const unsigned int base = w * WORD_BITS;
+        const unsigned int n = std::min<size_t>(WORD_BITS, a.size() - base);
+        uint64_t flags = 0;
+        for (unsigned int i = 0; i < n; i++)
+            flags |= uint64_t(op.overflows(a[base + i], b[base + i],
+                                           cells[base + i])) << i;
+        overflowed |= flags & valid[w];
+    }
+    return overflowed == 0;
+}
+
+// Applies op element-wise over two whole columns of cell types A and B into
+// a new column of their promoted type, or double for ops that return it.
+// The result is valid only where both inputs are, one AND per bitmap word.
+template <typename A, typename B, typename Op>
+Column combineCells(const std::vector<A>& a, const std::vector<uint64_t>& a_valid,
+                    const std::vector<B>& b, const std::vector<uint64_t>& b_valid,
+                    Op op) {
+    typedef typename Promote<A, B>::type P;
+    typedef decltype(op(P(), P())) R;
+    Column out;
+    out.type = CellTraits<R>::type;
+    out.valid.resize(a_valid.size());
+    for (unsigned int w = 0; w < a_valid.size(); w++)
+        out.valid[w] = a_valid[w] & b_valid[w];
+    std::vector<R>& cells = CellTraits<R>::cells(out);
+    cells.resize(a.size());
+    if (!applyCells<P>(a, b, out.valid, cells, op)) {
+        // An integer result does not fit, so the column is FLOAT64.
+        cells.clear();
+        out.type = FLOAT64;
+        out.f64.resize(a.size());
+        for (unsigned int i = 0; i < a.size(); i++)
+            out.f64[i] = op(double(a[i]), double(b[i]));
+    }
+    return out;
+}
+
+// Arithmetic kernels for combineColumns(). Division always gives FLOAT64.
+// overflows() computes an integer result and says whether it did not fit.
+struct AddCells {
+    template <typename T> T operator()(const T a, const T b) const { return a + b; }
+    bool overflows(const int64_t a, const int64_t b, int64_t& out) const {
+        return __builtin_add_overflow(a, b, &out);
+    }
+};
+struct SubtractCells {
+    template <typename T> T operator()(const T a, const T b) const { return a - b; }
+    bool overflows(const int64_t a, const int64_t b, int64_t& out) const {
+        return __builtin_sub_overflow(a, b, &out);
+    }
+};
+struct MultiplyCells {
+    template <typename T> T operator()(const T a, const T b) const { return a * b; }
+    bool overflows(const int64_t a, const int64_t b, int64_t& out) const {
+        return __builtin_mul_overflow(a, b, &out);
+    }
+};
+struct DivideCells {
+    template <typename T> double operator()(const T a, const T b) const {
+        return double(a) / double(b);
+    }
+};
+
+// Second level of the binary dispatch, once A is known.
+template <typename A, typename Op>
+struct CombineWith {
+    const std::vector<A>& a;
+    const Column& a_col;
+    const Column& b_col;
+    Op op;
+    Column result;
+    template <typename B> void operator()(const std::vector<B>& b) {
+        result = combineCells(a, a_col.valid, b, b_col.valid, op);
+    }
+};
+
+template <typename Op>
+struct Combine {
+    const Column& a_col;
+    const Column& b_col;
+    Op op;
+    Column result;
+    template <typename A> void operator()(const std::vector<A>& a) {
+        CombineWith<A, Op> with = {a, a_col, b_col, op, Column()};
+        visitNumeric(b_col, with);
+        result = std::move(with.result);
+    }
+};
+
+// Combines two numeric columns of any cell types with op.
+template <typename Op>
+Column combineColumns(const Column& a, const Column& b, Op op) {
+    Combine<Op> combine = {a, b, op, Column()};
+    visitNumeric(a, combine);
+    return std::move(combine.result);
+}
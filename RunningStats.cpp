@@ -0,0 +1,85 @@
+#include "RunningStats.h"
+#include <algorithm>
+
+
+namespace { // Anonymous namespace for helper constants.
+// Desired marker position increments for the 0.5 quantile.
+const double DESIRED_STEP[5] = {0, 0.25, 0.5, 0.75, 1};
+} // namespace
+
+
+void RunningStats::add(const double val) {
+    count_++;
+    sum_ += val;
+    if (val < min_) min_ = val;
+    if (val > max_) max_ = val;
+    // NaN values have no place in an ordering.
+    if (!std::isnan(val)) addToEstimator(val);
+}
+
+
+void RunningStats::addToEstimator(const double val) {
+    // Fill the markers with the first five values, kept sorted.
+    if (num_seen_ < 5) {
+        heights_[num_seen_++] = val;
+        std::sort(heights_, heights_ + num_seen_);
+        if (num_seen_ == 5) {
+            for (int i = 0; i < 5; i++) {
+                positions_[i] = i;
+                desired_[i] = 4 * DESIRED_STEP[i];
+            }
+        }
+        return;
+    }
+    num_seen_++;
+
+    // Find the cell the value falls in, extending the extremes if needed.
+    int cell;
+    if (val < heights_[0]) {
+        heights_[0] = val;
+        cell = 0;
+    } else if (val >= heights_[4]) {
+        heights_[4] = val;
+        cell = 3;
+    } else {
+        cell = 0;
+        while (val >= heights_[cell + 1]) cell++;
+    }
+    for (int i = cell + 1; i < 5; i++) positions_[i]++;
+    for (int i = 0; i < 5; i++) desired_[i] += DESIRED_STEP[i];
+
+    // Move the three middle markers towards their desired positions.
+    for (int i = 1; i < 4; i++) {
+        double d = desired_[i] - positions_[i];
+        if ((d >= 1 && positions_[i + 1] - positions_[i] > 1) ||
+            (d <= -1 && positions_[i - 1] - positions_[i] < -1)) {
+            int s = (d > 0) ? 1 : -1;
+            // Piecewise-parabolic prediction of the new height.
+            double h = heights_[i] + s / (positions_[i + 1] - positions_[i - 1]) *
+                ((positions_[i] - positions_[i - 1] + s) *
+                     (heights_[i + 1] - heights_[i]) /
+                     (positions_[i + 1] - positions_[i]) +
+                 (positions_[i + 1] - positions_[i] - s) *
+                     (heights_[i] - heights_[i - 1]) /
+                     (positions_[i] - positions_[i - 1]));
+            // Fall back to linear if the parabola breaks the ordering.
+            if (heights_[i - 1] < h && h < heights_[i + 1])
+                heights_[i] = h;
+            else
+                heights_[i] += s * (heights_[i + s] - heights_[i]) /
+                               (positions_[i + s] - positions_[i]);
+            positions_[i] += s;
+        }
+    }
+}
+
+
+double RunningStats::median() const {
+    if (num_seen_ == 0) return NAN;
+    if (num_seen_ >= 5) return heights_[2];
+    // Exact median of the few sorted values seen so far.
+    double median = heights_[num_seen_/2];
+    if (num_seen_ % 2 == 0)
+        median = (median + heights_[num_seen_/2 - 1])/2;
+    return median;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cmath>
+
+
+// Streaming statistics over a column, updated one value at a time so that
+// appended rows never require a rescan. The median is approximate once more
+// than five values have been seen.
+class RunningStats {
+public:
+    RunningStats() = default;
+    ~RunningStats() = default;
+
+    void add(const double val);
+
+    unsigned int count() const { return count_; }
+    double min() const { return min_; }
+    double max() const { return max_; }
+    double average() const { return sum_ / count_; }
+    double median() const;
+
+private:
+    unsigned int count_ = 0;
+    double sum_ = 0;
+    double min_ = INFINITY;
+    double max_ = -INFINITY;
+
+    // P-square median estimator (Jain & Chlamtac, 1985). Five markers track
+    // the minimum, quartiles, median and maximum of the values seen. Until
+    // five values arrive, heights_ simply holds them in sorted order.
+    void addToEstimator(const double val);
+    unsigned int num_seen_ = 0;
+    double heights_[5];
+    double positions_[5];
+    double desired_[5];
+};
@@ -0,0 +1,142 @@
+#include "Sketch.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+
+namespace { // Anonymous namespace for helper constants.
+const unsigned int HLL_PRECISION = 14; // log2 of the number of registers.
+const unsigned int KLL_K = 200; // Capacity of the top compactor.
+} // namespace
+
+
+// The splitmix64 finalizer.
+uint64_t hashBits(uint64_t bits) {
+    bits ^= bits >> 30;
+    bits *= 0xbf58476d1ce4e5b9ULL;
+    bits ^= bits >> 27;
+    bits *= 0x94d049bb133111ebULL;
+    bits ^= bits >> 31;
+    return bits;
+}
+
+
+HyperLogLog::HyperLogLog() : registers_(1 << HLL_PRECISION, 0) {}
+
+
+void HyperLogLog::add(const uint64_t hash) {
+    // The top bits pick a register, which keeps the longest run of leading
+    // zeros seen in the remaining bits.
+    unsigned int index = hash >> (64 - HLL_PRECISION);
+    uint64_t rest = hash << HLL_PRECISION;
+    uint8_t rank = rest ? __builtin_clzll(rest) + 1 : 64 - HLL_PRECISION + 1;
+    if (rank > registers_[index]) registers_[index] = rank;
+}
+
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    for (unsigned int i = 0; i < registers_.size(); i++)
+        registers_[i] = std::max(registers_[i], other.registers_[i]);
+}
+
+
+double HyperLogLog::estimate() const {
+    const double m = registers_.size();
+    double inverse_sum = 0;
+    unsigned int zeros = 0;
+    for (const auto reg : registers_) {
+        inverse_sum += std::ldexp(1.0, -reg);
+        if (reg == 0) zeros++;
+    }
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / inverse_sum;
+    // Small counts are better estimated from the empty registers.
+    if (estimate <= 2.5 * m && zeros > 0) estimate = m * std::log(m / zeros);
+    return estimate;
+}
+
+
+double HyperLogLog::standardError() const {
+    return 1.04 / std::sqrt(double(registers_.size()));
+}
+
+
+KllSketch::KllSketch(const uint64_t seed) : levels_(1), random_(seed) {}
+
+
+void KllSketch::add(const double val) {
+    // NaN values have no place in an ordering, and would break the sorts.
+    if (std::isnan(val)) return;
+    levels_[0].push_back(val);
+    count_++;
+    if (levels_[0].size() >= capacity(0)) compress();
+}
+
+
+void KllSketch::merge(const KllSketch& other) {
+    if (other.levels_.size() > levels_.size()) levels_.resize(other.levels_.size());
+    for (unsigned int h = 0; h < other.levels_.size(); h++)
+        levels_[h].insert(levels_[h].end(),
+                          other.levels_[h].begin(), other.levels_[h].end());
+    count_ += other.count_;
+    while (compress()) {}
+}
+
+
+// Value at normalized rank q, where q = 0.5 is the median.
+double KllSketch::quantile(const double q) const {
+    std::vector<std::pair<double, unsigned long long>> weighted;
+    unsigned long long total = 0;
+    for (unsigned int h = 0; h < levels_.size(); h++) {
+        for (const auto val : levels_[h]) weighted.push_back({val, 1ULL << h});
+        total += levels_[h].size() << h;
+    }
+    if (weighted.empty()) return NAN;
+    std::sort(weighted.begin(), weighted.end());
+
+    double target = std::min(std::max(q, 0.0), 1.0) * total;
+    unsigned long long seen = 0;
+    for (const auto& item : weighted) {
+        seen += item.second;
+        if (seen >= target) return item.first;
+    }
+    return weighted.back().first;
+}
+
+
+// Normalized rank error at about 99% confidence, from the empirical fit in
+// the Apache DataSketches KLL implementation.
+double KllSketch::rankError() const {
+    return 2.296 / std::pow(double(KLL_K), 0.9723);
+}
+
+
+// Lower levels hold fewer values, shrinking by 2/3 per level down.
+unsigned int KllSketch::capacity(const unsigned int level) const {
+    unsigned int depth = levels_.size() - level - 1;
+    return std::max(2u, (unsigned int)std::ceil(KLL_K * std::pow(2.0 / 3, depth)));
+}
+
+
+// Compacts every level that is at capacity into the one above it. Returns
+// whether anything moved, as adding a level shrinks the lower capacities.
+bool KllSketch::compress() {
+    bool compacted = false;
+    for (unsigned int h = 0; h < levels_.size(); h++) {
+        if (levels_[h].size() < capacity(h)) continue;
+        if (h + 1 == levels_.size()) levels_.emplace_back();
+        std::vector<double>& level = levels_[h];
+        std::sort(level.begin(), level.end());
+        // An odd value out stays behind so the rest pair up evenly.
+        bool odd = level.size() % 2;
+        double held = odd ? level.back() : 0;
+        if (odd) level.pop_back();
+
+        random_ = hashBits(random_ + 1);
+        for (unsigned int i = random_ & 1; i < level.size(); i += 2)
+            levels_[h + 1].push_back(level[i]);
+        level.clear();
+        if (odd) level.push_back(held);
+        compacted = true;
+    }
+    return compacted;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+
+// Mixes the bits of a value into a well distributed 64 bit hash.
+uint64_t hashBits(uint64_t bits);
+
+
+// HyperLogLog distinct value counter (Flajolet et al., 2007) over 64 bit
+// hashes. Uses 2^14 one byte registers, for a standard error near 0.8%.
+// Sketches built over separate parts of a column merge into one.
+class HyperLogLog {
+public:
+    HyperLogLog();
+    ~HyperLogLog() = default;
+
+    void add(const uint64_t hash);
+    void merge(const HyperLogLog& other);
+    double estimate() const;
+    double standardError() const;
+
+private:
+    std::vector<uint8_t> registers_;
+};
+
+
+// KLL quantile sketch (Karnin, Lang & Liberty, 2016). Values pass through
+// a stack of compactors; when a level fills, it is sorted and every other
+// value moves up a level with double the weight. Sketches merge level by
+// level, so parts of a column can be sketched on separate threads. NaN
+// values are skipped.
+class KllSketch {
+public:
+    explicit KllSketch(const uint64_t seed = 1);
+    ~KllSketch() = default;
+
+    void add(const double val);
+    void merge(const KllSketch& other);
+    double quantile(const double q) const;
+    unsigned long long count() const { return count_; }
+    double rankError() const;
+
+private:
+    unsigned long long count_ = 0;
+    std::vector<std::vector<double>> levels_;
+    uint64_t random_; // State for choosing which half of a level survives.
+
+    unsigned int capacity(const unsigned int level) const;
+    bool compress();
+};
@@ -1,10 +1,20 @@
 #include "Table.h"
+#include <glob.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstring>
+#include <deque>
 #include <fstream>
 #include <numeric>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 
 
 // Split input string into vector of strings on char delimiter.
@@ -53,6 +63,379 @@ void quickSort(std::vector<double>& values) {
     quickSort(values, 0, values.size());
 }
 
+// Expands a READCSV file spec into file names. The spec is a comma separated
+// list whose entries may use shell wildcards; matches are taken in sorted
+// order and the list order is kept, so the row order is deterministic. A
+// wildcard entry that matches no files is reported rather than skipped.
+bool expandFilenames(const std::string& spec,
+                     std::vector<std::string>& filenames) {
+    for (const auto& entry : split(spec, ',')) {
+        if (entry.find_first_of("*?[") == std::string::npos) {
+            filenames.push_back(entry);
+            continue;
+        }
+        glob_t matches;
+        bool matched = (glob(entry.c_str(), 0, nullptr, &matches) == 0);
+        if (matched) {
+            for (size_t i = 0; i < matches.gl_pathc; i++)
+                filenames.push_back(matches.gl_pathv[i]);
+        }
+        globfree(&matches);
+        if (!matched) {
+            std::cout << "No CSV files match: " << entry << "\n\n";
+            return false;
+        }
+    }
+    if (filenames.empty()) {
+        std::cout << "No CSV files match: " << spec << "\n\n";
+        return false;
+    }
+    return true;
+}
+
+// Size of a file in bytes, or 0 if it cannot be read.
+long long fileSize(const std::string& filename) {
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) return 0;
+    return info.st_size;
+}
+
+// Splits a CSV line on commas, keeping empty fields.
+std::vector<std::string> splitFields(const std::string& line) {
+    std::vector<std::string> headers;
+    std::stringstream ss(line);
+    while (ss) {
+        std::string cel;
+        if (!std::getline(ss, cel, ',')) break;
+        headers.push_back(cel);
+    }
+    return headers;
+}
+
+// Number of rows read to infer column types.
+const unsigned int SCHEMA_SAMPLE_ROWS = 1000;
+
+// Hash join on keys of one type. For each row of this Table, finds the last
+// row of other with an equal key; and marks rows of other that match any
+// row of this Table. Null keys never match.
+template <typename K>
+void matchKeys(const std::vector<K>& this_keys, const std::vector<uint64_t>& this_valid,
+               const std::vector<K>& other_keys, const std::vector<uint64_t>& other_valid,
+               std::vector<int>& this_to_other_row, std::vector<char>& other_matched) {
+    std::unordered_map<K, unsigned int> other_rows;
+    for (unsigned int i = 0; i < other_keys.size(); i++)
+        if (testBit(other_valid, i)) other_rows[other_keys[i]] = i;
+    std::unordered_set<K> this_key_set;
+    for (unsigned int j = 0; j < this_keys.size(); j++) {
+        if (!testBit(this_valid, j)) continue;
+        this_key_set.insert(this_keys[j]);
+        auto found = other_rows.find(this_keys[j]);
+        if (found != other_rows.end()) this_to_other_row[j] = found->second;
+    }
+    for (unsigned int i = 0; i < other_keys.size(); i++)
+        if (testBit(other_valid, i) && this_key_set.count(other_keys[i]))
+            other_matched[i] = true;
+}
+
+// Column kernels, dispatched on the cell type by visitNumeric().
+struct GatherValues { // Valid cells as doubles, in row order.
+    const std::vector<uint64_t>& valid;
+    std::vector<double>& vals;
+    template <typename T> void operator()(const std::vector<T>& cells) {
+        for (unsigned int w = 0; w < valid.size(); w++) {
+            // Visit only the set bits, lowest first.
+            for (uint64_t bits = valid[w]; bits; bits &= bits - 1)
+                vals.push_back(cells[w * WORD_BITS + __builtin_ctzll(bits)]);
+        }
+    }
+};
+
+struct SumValues {
+    const std::vector<uint64_t>& valid;
+    double sum;
+    template <typename T> void operator()(const std::vector<T>& cells) {
+        sum = maskedReduce(cells, valid, 0.0, T(0),
+                           [](double acc, T v) { return acc + v; });
+    }
+};
+
+// Prints the min or max in the column's own type. NaN values are skipped,
+// so a float column starts from NaN and any number replaces it; a column of
+// only NaN values prints nothing.
+struct PrintExtreme {
+    const std::vector<uint64_t>& valid;
+    bool is_max;
+    template <typename T> void operator()(const std::vector<T>& cells) {
+        T val;
+        if (is_max) {
+            T start = std::numeric_limits<T>::has_quiet_NaN ?
+                      std::numeric_limits<T>::quiet_NaN() : lowest<T>();
+            val = maskedReduce(cells, valid, start, start, [](T acc, T v) {
+                return (v > acc || acc != acc) ? v : acc; });
+        } else {
+            T start = std::numeric_limits<T>::has_quiet_NaN ?
+                      std::numeric_limits<T>::quiet_NaN() : highest<T>();
+            val = maskedReduce(cells, valid, start, start, [](T acc, T v) {
+                return (v < acc || acc != acc) ? v : acc; });
+        }
+        if (val == val) std::cout << val << std::endl;
+    }
+};
+
+// Cell hashes for HyperLogLog. Equal numbers hash equally, ie. 0 and -0.
+inline uint64_t hashCell(const int64_t val) { return hashBits(val); }
+inline uint64_t hashCell(const uint32_t code) { return hashBits(code); }
+inline uint64_t hashCell(const double val) {
+    if (val == 0) return hashBits(0);
+    uint64_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    return hashBits(bits);
+}
+inline uint64_t hashCell(const float val) { return hashCell(double(val)); }
+
+// Rows handled by one thread when building a sketch.
+const unsigned int SKETCH_CHUNK_ROWS = 1 << 16;
+
+// Block sampling: each bitmap word's 64 rows are read or skipped together,
+// chosen by a hash of the word index so repeated queries see one sample.
+inline bool sampledWord(const unsigned int w, const unsigned int percent) {
+    return percent >= 100 || hashBits(w) % 100 < percent;
+}
+
+// Adds the valid cells of words [w_begin, w_end), from first_row on, to a
+// distinct count and, for numbers, a quantile sketch.
+struct SketchCells {
+    const std::vector<uint64_t>& valid;
+    unsigned int first_row, w_begin, w_end, percent;
+    bool with_quantiles;
+    HyperLogLog& distinct;
+    KllSketch& quantiles;
+    template <typename T> void operator()(const std::vector<T>& cells) {
+        for (unsigned int w = w_begin; w < w_end; w++) {
+            if (!sampledWord(w, percent)) continue;
+            uint64_t bits = valid[w];
+            if (w == first_row / WORD_BITS) // Skip rows already sketched.
+                bits &= ALL_VALID << (first_row % WORD_BITS);
+            for (; bits; bits &= bits - 1) {
+                T val = cells[w * WORD_BITS + __builtin_ctzll(bits)];
+                distinct.add(hashCell(val));
+                if (with_quantiles) quantiles.add(val);
+            }
+        }
+    }
+};
+
+// Per block totals of a block sample, for a ratio estimate of the mean and
+// its variance (Cochran, Sampling Techniques, 1977, section 6.13). With
+// at_most set, each value counts as 1 if it is at most threshold and 0
+// otherwise, so the estimate is the fraction of non-NaN values at or below
+// it.
+struct SampleSums {
+    const std::vector<uint64_t>& valid;
+    unsigned int percent;
+    bool at_most;
+    double threshold;
+    double blocks, sum_y, sum_n, sum_yy, sum_nn, sum_yn;
+    template <typename T> void operator()(const std::vector<T>& cells) {
+        for (unsigned int w = 0; w < valid.size(); w++) {
+            if (!sampledWord(w, percent)) continue;
+            const uint64_t bits = valid[w];
+            const unsigned int base = w * WORD_BITS;
+            const unsigned int n = std::min<size_t>(WORD_BITS, cells.size() - base);
+            double y = 0, nans = 0;
+            for (unsigned int i = 0; i < n; i++) {
+                const double cell = double(cells[base + i]);
+                const bool is_valid = (bits >> i) & 1;
+                double val = at_most ? double(cell <= threshold) : cell;
+                y += is_valid ? val : 0.0;
+                // NaN values are left out of fractions, as out of sketches.
+                if (at_most) nans += (is_valid && std::isnan(cell));
+            }
+            double count = __builtin_popcountll(bits) - nans;
+            blocks++;
+            sum_y += y;
+            sum_n += count;
+            sum_yy += y * y;
+            sum_nn += count * count;
+            sum_yn += y * count;
+        }
+    }
+
+    // Variance of the ratio estimate sum_y / sum_n, for a sample of blocks
+    // out of total_blocks.
+    double variance(const double total_blocks) const {
+        double ratio = sum_y / sum_n;
+        double fraction = blocks / total_blocks;
+        double mean_n = sum_n / blocks;
+        double residual = sum_yy - 2 * ratio * sum_yn + ratio * ratio * sum_nn;
+        return (1 - fraction) / (blocks * mean_n * mean_n) *
+               std::max(0.0, residual) / (blocks - 1);
+    }
+};
+
+// Sliding window kernels. Each fills output rows [begin, end) for trailing
+// windows of window rows, reading from window - 1 rows before begin so that
+// chunks can run independently. A row's result is null until a full window
+// has passed, or if its window has no valid cells. NaN values make a sum
+// or average NaN and are ignored by min and max, as in the whole column
+// aggregates.
+const unsigned int ROLLING_CHUNK_ROWS = 1 << 16;
+
+inline void setBit(std::vector<uint64_t>& bits, const unsigned int row) {
+    bits[row / WORD_BITS] |= uint64_t(1) << (row % WORD_BITS);
+}
+
+// Adds sign times val to sum. Returns false if an integer sum overflows,
+// which is checked rather than left undefined.
+template <typename R>
+inline bool addToSum(R& sum, const R val, const int sign) {
+    sum += sign * val;
+    return true;
+}
+inline bool addToSum(int64_t& sum, const int64_t val, const int sign) {
+    return sign > 0 ? !__builtin_add_overflow(sum, val, &sum)
+                    : !__builtin_sub_overflow(sum, val, &sum);
+}
+
+// Running sum: add the row entering the window, subtract the one leaving.
+// Floating point sums are recomputed once per window length so rounding
+// error cannot build up, which keeps the total work O(n). Returns false if
+// an integer sum overflowed, leaving out incomplete.
+template <typename T, typename R>
+bool rollingSum(const std::vector<T>& cells, const std::vector<uint64_t>& valid,
+                const unsigned int window, const unsigned int begin,
+                const unsigned int end, const bool average,
+                std::vector<R>& out, std::vector<uint64_t>& out_valid) {
+    const unsigned int start = (begin >= window) ? begin - window + 1 : 0;
+    R sum = 0;
+    unsigned int count = 0, nans = 0;
+    auto update = [&](unsigned int row, int sign) -> bool {
+        if (!testBit(valid, row)) return true;
+        count += sign;
+        if (std::isnan(double(cells[row]))) nans += sign;
+        else return addToSum(sum, R(cells[row]), sign);
+        return true;
+    };
+    for (unsigned int row = start; row < end; row++) {
+        if (!update(row, 1)) return false;
+        if (row >= start + window && !update(row - window, -1)) return false;
+        if (row < begin || row + 1 < window) continue;
+
+        if (std::is_floating_point<R>::value && (row - begin) % window == 0) {
+            sum = 0;
+            for (unsigned int i = row + 1 - window; i <= row; i++)
+                if (testBit(valid, i) && !std::isnan(double(cells[i])))
+                    sum += R(cells[i]);
+        }
+        if (count == 0) continue;
+        if (nans > 0) out[row] = std::numeric_limits<R>::quiet_NaN();
+        else out[row] = average ? R(double(sum) / count) : sum;
+        setBit(out_valid, row);
+    }
+    return true;
+}
+
+// Monotonic deque of row numbers whose values only get worse towards the
+// back; the front is always the best value in the window.
+template <typename T>
+void rollingExtreme(const std::vector<T>& cells, const std::vector<uint64_t>& valid,
+                    const unsigned int window, const unsigned int begin,
+                    const unsigned int end, const bool is_max,
+                    std::vector<T>& out, std::vector<uint64_t>& out_valid) {
+    const unsigned int start = (begin >= window) ? begin - window + 1 : 0;
+    std::deque<unsigned int> best;
+    for (unsigned int row = start; row < end; row++) {
+        if (testBit(valid, row) && !std::isnan(double(cells[row]))) {
+            const T val = cells[row];
+            while (!best.empty() && (is_max ? cells[best.back()] <= val
+                                            : cells[best.back()] >= val))
+                best.pop_back();
+            best.push_back(row);
+        }
+        if (!best.empty() && best.front() + window <= row) best.pop_front();
+        if (row < begin || row + 1 < window || best.empty()) continue;
+        out[row] = cells[best.front()];
+        setBit(out_valid, row);
+    }
+}
+
+// Runs a window kernel over chunks of 64-row aligned blocks, so threads
+// never share a bitmap word. Chunks overlap the previous chunk by the window
+// length less one row; very long windows run as one chunk.
+template <typename R, typename Kernel>
+Column rollingChunks(const unsigned int rows, const unsigned int window,
+                     Kernel kernel) {
+    Column out;
+    out.type = CellTraits<R>::type;
+    std::vector<R>& cells = CellTraits<R>::cells(out);
+    cells.assign(rows, std::numeric_limits<R>::has_quiet_NaN ? R(NAN) : R(0));
+    out.valid.assign(numWords(rows), 0);
+
+    unsigned int num_threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned int chunk_rows = std::max(ROLLING_CHUNK_ROWS,
+                                       (rows + num_threads - 1) / num_threads);
+    chunk_rows = (chunk_rows + WORD_BITS - 1) / WORD_BITS * WORD_BITS;
+    if (window >= chunk_rows) chunk_rows = std::max(rows, 1u);
+
+    std::vector<std::thread> threads;
+    for (unsigned int begin = chunk_rows; begin < rows; begin += chunk_rows) {
+        unsigned int end = std::min(rows, begin + chunk_rows);
+        threads.emplace_back([&, begin, end]() {
+            kernel(begin, end, cells, out.valid);
+        });
+    }
+    kernel(0, std::min(rows, chunk_rows), cells, out.valid);
+    for (auto& thread : threads) thread.join();
+    return out;
+}
+
+// Dispatches a ROLLING command on the cell type of the column.
+struct RollingWindow {
+    const std::vector<uint64_t>& valid;
+    unsigned int window;
+    std::string stat; // AVG, SUM, MIN or MAX.
+    Column result;
+    template <typename T> void operator()(const std::vector<T>& cells) {
+        // Integer sums stay exact unless they overflow; other sums and
+        // averages are FLOAT64.
+        typedef typename Promote<T, int64_t>::type S;
+        const std::vector<uint64_t>& v = valid;
+        const unsigned int w = window;
+        const unsigned int rows = cells.size();
+        bool is_max = (stat == "MAX");
+        std::atomic<bool> overflowed(false); // Set by any chunk.
+        if (stat == "AVG" || stat == "SUM") {
+            bool average = (stat == "AVG");
+            if (average)
+                result = rollingChunks<double>(rows, w,
+                    [&](unsigned int b, unsigned int e, std::vector<double>& out,
+                        std::vector<uint64_t>& out_valid) {
+                        rollingSum(cells, v, w, b, e, true, out, out_valid);
+                    });
+            else
+                result = rollingChunks<S>(rows, w,
+                    [&](unsigned int b, unsigned int e, std::vector<S>& out,
+                        std::vector<uint64_t>& out_valid) {
+                        if (!rollingSum(cells, v, w, b, e, false, out, out_valid))
+                            overflowed = true;
+                    });
+            // An integer sum that does not fit makes the column FLOAT64.
+            if (overflowed)
+                result = rollingChunks<double>(rows, w,
+                    [&](unsigned int b, unsigned int e, std::vector<double>& out,
+                        std::vector<uint64_t>& out_valid) {
+                        rollingSum(cells, v, w, b, e, false, out, out_valid);
+                    });
+        } else {
+            result = rollingChunks<T>(rows, w,
+                [&](unsigned int b, unsigned int e, std::vector<T>& out,
+                    std::vector<uint64_t>& out_valid) {
+                    rollingExtreme(cells, v, w, b, e, is_max, out, out_valid);
+                });
+        }
+    }
+};
+
 // Enum and hash map for quick command lookups in parseArg().
 enum CommandsEnum {
     READCSV,
@@ -75,6 +458,18 @@ enum CommandsEnum {
     SUBTRACTCOLUMNS,
     DIVIDECOLUMNS,
     MULTIPLYCOLUMNS,
+    WATCH,
+    REFRESH,
+    FOLLOW,
+    SCHEMA,
+    PRINTSCHEMA,
+    DISTINCTCOUNT,
+    APPROXIMATE,
+    SAMPLE,
+    ROLLINGAVG,
+    ROLLINGSUM,
+    ROLLINGMIN,
+    ROLLINGMAX,
     QUIT,
 };
 static std::unordered_map<std::string, CommandsEnum> command_to_int{
@@ -98,6 +493,18 @@ static std::unordered_map<std::string, CommandsEnum> command_to_int{
     {"SUBTRACTCOLUMNS", SUBTRACTCOLUMNS},
     {"DIVIDECOLUMNS",   DIVIDECOLUMNS},
     {"MULTIPLYCOLUMNS", MULTIPLYCOLUMNS},
+    {"WATCH",           WATCH},
+    {"REFRESH",         REFRESH},
+    {"FOLLOW",          FOLLOW},
+    {"SCHEMA",          SCHEMA},
+    {"PRINTSCHEMA",     PRINTSCHEMA},
+    {"DISTINCTCOUNT",   DISTINCTCOUNT},
+    {"APPROXIMATE",     APPROXIMATE},
+    {"SAMPLE",          SAMPLE},
+    {"ROLLINGAVG",      ROLLINGAVG},
+    {"ROLLINGSUM",      ROLLINGSUM},
+    {"ROLLINGMIN",      ROLLINGMIN},
+    {"ROLLINGMAX",      ROLLINGMAX},
     {"QUIT",            QUIT},
 };
 } // namespace
@@ -128,6 +535,13 @@ bool Table::parseArg(const std::string& arg) {
     // Run the appropriate Table method based on input command.
     switch (command_to_int[command]) {
         case(READCSV):
+            // File names may themselves contain '-', ie. part-*.csv.
+            if (params.size() > 2) {
+                std::string filename(params[1]);
+                for (unsigned int i = 2; i < params.size(); i++)
+                    filename += "-" + params[i];
+                return readCSV(filename);
+            }
             if (checkParams(params.size(), 2))
                 return readCSV(params[1]);
             return false;
@@ -159,13 +573,17 @@ bool Table::parseArg(const std::string& arg) {
             return false;
         case(INNERJOIN):
             if (checkParams(params.size(), 3)) {
-                Table other(params[1]);
+                Table other;
+                other.schema_ = schema_;
+                if (!other.readCSV(params[1])) return false;
                 return innerJoin(other, params[2]);
             }
             return false;
         case(OUTERJOIN):
             if (checkParams(params.size(), 3)) {
-                Table other(params[1]);
+                Table other;
+                other.schema_ = schema_;
+                if (!other.readCSV(params[1])) return false;
                 return outerJoin(other, params[2]);
             }
             return false;
@@ -201,6 +619,41 @@ bool Table::parseArg(const std::string& arg) {
             if (checkParams(params.size(), 3)) 
                 return multiplyColumns(stoi(params[1]), stoi(params[2]));
             return false;
+        case(WATCH):
+            if (checkParams(params.size(), 3))
+                return addWatch(params[1], stoi(params[2]));
+            return false;
+        case(REFRESH):
+            return refreshCSV();
+        case(FOLLOW):
+            if (params.size() == 1) return followCSV(1);
+            if (checkParams(params.size(), 2))
+                return followCSV(stoi(params[1]));
+            return false;
+        case(SCHEMA):
+            return setSchema(params);
+        case(PRINTSCHEMA):
+            return printSchema();
+        case(DISTINCTCOUNT):
+            if (checkParams(params.size(), 2))
+                return printDistinctCount(stoi(params[1]));
+            return false;
+        case(APPROXIMATE):
+            if (checkParams(params.size(), 2))
+                return setApproximate(params[1]);
+            return false;
+        case(SAMPLE):
+            if (checkParams(params.size(), 2))
+                return setSample(stoi(params[1]));
+            return false;
+        case(ROLLINGAVG):
+        case(ROLLINGSUM):
+        case(ROLLINGMIN):
+        case(ROLLINGMAX):
+            if (checkParams(params.size(), 3))
+                return rollingColumn(command.substr(7), stoi(params[1]),
+                                     stoi(params[2]));
+            return false;
         case(QUIT):
             std::exit(0);
     }
@@ -214,6 +667,17 @@ bool Table::readCSV(const std::string& filename) {
         return false;
     }
 
+    std::vector<std::string> filenames;
+    if (!expandFilenames(filename, filenames)) return false;
+    if (filenames.size() == 1) return readCSVFile(filenames[0]);
+    if (!readCSVShards(filenames)) return false;
+    name_ = filename;
+    return true;
+}
+
+
+bool Table::readCSVFile(const std::string& filename,
+                        std::vector<ColumnType> types) {
     // This would need to be more robust to error handling in production.
     std::ifstream csv_file;
     csv_file.open("./" + filename);
@@ -226,28 +690,358 @@ bool Table::readCSV(const std::string& filename) {
     std::string line;
     // Read in column headers.
     std::getline(csv_file, line);
-    std::stringstream ss(line);
-    while (ss) {
-        std::string cel;
-        if (!std::getline(ss, cel, ',')) break;
-        headers_.push_back(cel);
+    headers_ = splitFields(line);
+    // A header without a newline may still be being written. There are no
+    // rows yet, and REFRESH reads from the start of the file until the
+    // header is complete.
+    if (csv_file.eof()) partial_header_ = line;
+    csv_file.clear();
+    // Column types come from a sample of rows unless given, ie. by shards.
+    if (types.size() != headers_.size()) types = inferSchema(csv_file, headers_);
+    data_.resize(headers_.size());
+    file_fields_.resize(headers_.size());
+    for (unsigned int col = 0; col < data_.size(); col++) {
+        data_[col].type = types[col];
+        file_fields_[col] = col;
     }
 
-    // Read in the numeric data_.
-    while (std::getline(csv_file, line)) {
+    // Read in the data_, remembering where it ends for REFRESH.
+    read_offset_ = readRows(csv_file, false);
+    if (!partial_header_.empty()) {
+        read_offset_ = 0;
+        partial_bytes_ = partial_header_.size();
+    }
+    csv_file.close();
+    return true;
+}
+
+
+// Picks the narrowest type that holds every cell in the first rows after
+// the headers, then applies SCHEMA overrides. Columns with no values in the
+// sample are FLOAT64. csv_file is left where it was.
+std::vector<ColumnType> Table::inferSchema(std::istream& csv_file,
+        const std::vector<std::string>& headers) const {
+    std::vector<ColumnType> types(headers.size(), INT64);
+    std::vector<char> seen(headers.size(), false);
+    std::streampos start = csv_file.tellg();
+    std::string line;
+    for (unsigned int row = 0;
+         row < SCHEMA_SAMPLE_ROWS && std::getline(csv_file, line); row++) {
         std::stringstream ss(line);
-        std::vector<double> row;
-
-        while (ss) {
-            std::string cell;
-            if (!std::getline(ss, cell, ',')) break;
-            // Would ideally want to handle bad/varied input...
-            if (cell.empty()) row.push_back(NAN); // If cell empty, NaN.
-            else row.push_back(stod(cell));
+        std::string cell;
+        for (unsigned int col = 0;
+             col < types.size() && std::getline(ss, cell, ','); col++) {
+            if (cell.empty()) continue;
+            types[col] = classifyText(cell, types[col]);
+            seen[col] = true;
+        }
+    }
+    csv_file.clear();
+    csv_file.seekg(start);
+
+    for (unsigned int col = 0; col < types.size(); col++) {
+        if (!seen[col]) types[col] = FLOAT64;
+        auto given = schema_.find(headers[col]);
+        if (given != schema_.end()) types[col] = given->second;
+    }
+    return types;
+}
+
+
+// Parses SCHEMA parameters of the form [column name]=[type]. The types are
+// used for CSV files read afterwards, and loaded columns are converted now.
+// A loaded column with cells that do not fit its type is left unchanged and
+// reported, and its entry is not kept.
+bool Table::setSchema(const std::vector<std::string>& params) {
+    std::unordered_map<std::string, ColumnType> given;
+    for (unsigned int i = 1; i < params.size(); i++) {
+        std::vector<std::string> pair = split(params[i], '=');
+        ColumnType type;
+        if (pair.size() != 2 || !parseType(pair[1], type)) {
+            std::cout << "Bad schema entry: " << params[i] << "\n\n";
+            return false;
+        }
+        given[pair[0]] = type;
+    }
+    bool applied = true;
+    for (const auto& entry : given) {
+        bool fits = true;
+        for (unsigned int col = 0; col < headers_.size(); col++)
+            if (headers_[col] == entry.first)
+                fits = convertColumn(data_[col], entry.second) && fits;
+        if (fits) {
+            schema_[entry.first] = entry.second;
+            continue;
+        }
+        std::cout << "Column does not fit " << typeName(entry.second) << ": "
+                  << entry.first << "\n\n";
+        applied = false;
+    }
+    rebuildWatches();
+    return applied;
+}
+
+
+bool Table::printSchema() const {
+    for (unsigned int col = 0; col < headers_.size(); col++)
+        std::cout << headers_[col] << ":" << typeName(data_[col].type) << ",";
+    std::cout << std::endl;
+    return true;
+}
+
+
+// Loads several CSV files with the same headers into this Table. Files are
+// parsed in parallel, largest first so a big file is not left until last,
+// and then appended in the order given. Column types are inferred from one
+// file and shared, so every shard parses to the same schema.
+bool Table::readCSVShards(const std::vector<std::string>& filenames) {
+    // Types come from the first file with rows, since a file holding only
+    // headers would make every column FLOAT64.
+    std::vector<ColumnType> types;
+    for (const auto& filename : filenames) {
+        std::ifstream csv_file;
+        csv_file.open("./" + filename);
+        if (!csv_file) {
+            std::cout << "Unable to open CSV file: " << filename << "\n\n";
+            return false;
+        }
+        std::string line;
+        std::getline(csv_file, line);
+        csv_file.clear();
+        types = inferSchema(csv_file, splitFields(line));
+        if (csv_file.peek() != std::ifstream::traits_type::eof()) break;
+    }
+
+    std::vector<unsigned int> order(filenames.size());
+    std::vector<long long> sizes(filenames.size());
+    for (unsigned int i = 0; i < filenames.size(); i++) {
+        order[i] = i;
+        sizes[i] = fileSize(filenames[i]);
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&sizes](unsigned int a, unsigned int b) { return sizes[a] > sizes[b]; });
+
+    std::vector<Table> shards(filenames.size());
+    std::vector<char> loaded(filenames.size(), false);
+    std::atomic<unsigned int> next(0);
+    auto worker = [&]() {
+        unsigned int i;
+        while ((i = next++) < order.size()) {
+            unsigned int file = order[i];
+            loaded[file] = shards[file].readCSVFile(filenames[file], types);
+        }
+    };
+    unsigned int num_threads = std::min<unsigned int>(
+        std::max(1u, std::thread::hardware_concurrency()), filenames.size());
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < num_threads; t++) threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads) thread.join();
+
+    // Check every shard before touching this Table.
+    for (unsigned int i = 0; i < shards.size(); i++) {
+        if (!loaded[i]) {
+            std::cout << "Unable to load CSV file: " << filenames[i] << "\n\n";
+            return false;
         }
-        data_.push_back(row);
+        if (shards[i].headers_ != shards[0].headers_) {
+            std::cout << "CSV headers do not match: " << filenames[i] << "\n\n";
+            return false;
+        }
+    }
+
+    headers_ = shards[0].headers_;
+    data_.resize(headers_.size());
+    file_fields_.resize(headers_.size());
+    for (unsigned int col = 0; col < data_.size(); col++) {
+        data_[col].type = types[col];
+        file_fields_[col] = col;
     }
+    // A shard whose column widened while parsing widens the whole column.
+    // Each shard is freed once appended, so the cells are held twice for at
+    // most one shard at a time.
+    for (auto& shard : shards) {
+        for (unsigned int col = 0; col < data_.size(); col++)
+            appendCells(data_[col], num_rows_, shard.data_[col], shard.num_rows_);
+        num_rows_ += shard.num_rows_;
+        shard = Table();
+    }
+    sharded_ = true;
+    return true;
+}
+
+
+// Parses rows from the current position of csv_file to its end. Returns
+// the file offset just past the last complete line. A last line that has no
+// newline yet may be one a writer is partway through: with complete_only it
+// is left for the next call, otherwise it is parsed as a provisional row.
+std::streamoff Table::readRows(std::istream& csv_file, const bool complete_only) {
+    std::streamoff offset = csv_file.tellg();
+    std::string line;
+    while (std::getline(csv_file, line)) {
+        if (csv_file.eof()) { // Unterminated line.
+            if (complete_only) break;
+            partial_row_ = num_rows_;
+            partial_bytes_ = line.size();
+            parseRow(line);
+            break;
+        }
+        offset += line.size() + 1;
+        if (!line.empty()) parseRow(line);
+    }
+    return offset;
+}
+
+
+// Each column takes the field it was loaded from, so rows still line up
+// after columns are deleted.
+void Table::parseRow(const std::string& line) {
+    std::vector<std::string> fields = splitFields(line);
+    for (unsigned int col = 0; col < data_.size(); col++) {
+        int field = file_fields_[col];
+        // Short rows, including a trailing empty cell, are padded with
+        // nulls. So are columns added by joins or arithmetic since the file
+        // was read.
+        if (field < 0 || field >= int(fields.size())) {
+            pushNull(data_[col], num_rows_);
+            continue;
+        }
+        // Empty cells are null; a literal "nan" is a valid number. Cells
+        // that do not fit the column's type widen it, ie. to STRING.
+        pushText(data_[col], num_rows_, fields[field]);
+    }
+    num_rows_++;
+}
+
+
+// Parses any rows appended to the CSV file since it was last read and
+// folds them into the watched statistics.
+bool Table::refreshCSV(unsigned int& new_rows) {
+    new_rows = 0;
+    if (name_.empty()) {
+        std::cout << "No main table loaded.\n";
+        return false;
+    }
+    if (sharded_) {
+        std::cout << "Cannot refresh a table loaded from several files.\n\n";
+        return false;
+    }
+    std::ifstream csv_file;
+    csv_file.open("./" + name_);
+    if (!csv_file) {
+        std::cout << "Unable to open CSV file: " << name_ << "\n\n";
+        return false;
+    }
+    csv_file.seekg(0, std::ios::end);
+    std::streamoff file_size = csv_file.tellg();
+    if (file_size < read_offset_ + partial_bytes_) {
+        std::cout << "CSV file was truncated: " << name_ << "\n\n";
+        return false;
+    }
+    // Nothing appended.
+    if (file_size == read_offset_ + partial_bytes_) return true;
+
+    // A provisional row from an unterminated line is dropped and parsed
+    // again below, with the rest of its line.
+    if (partial_row_ >= 0) deleteRow(partial_row_);
+    unsigned int first_row = num_rows_;
+    csv_file.seekg(read_offset_);
+    if (!partial_header_.empty()) {
+        // Rows can follow once the header line is complete, as long as the
+        // writer did not add to it.
+        std::string header;
+        std::getline(csv_file, header);
+        if (header != partial_header_) {
+            std::cout << "CSV headers changed: " << name_ << "\n\n";
+            return false;
+        }
+        partial_header_.clear();
+        partial_bytes_ = 0;
+    }
+    read_offset_ = readRows(csv_file, true);
     csv_file.close();
+    new_rows = num_rows_ - first_row;
+    updateWatches(first_row);
+    return true;
+}
+
+
+bool Table::refreshCSV() {
+    unsigned int new_rows;
+    if (!refreshCSV(new_rows)) return false;
+    return printWatches();
+}
+
+
+// Polls the CSV file like tail -f, ingesting appended rows and printing the
+// watched statistics whenever they change. Runs until the program is killed.
+bool Table::followCSV(const unsigned int interval) {
+    if (interval == 0) {
+        std::cout << "Bad parameters. Check help.\n\n";
+        return false;
+    }
+    printWatches();
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(interval));
+        unsigned int new_rows;
+        if (!refreshCSV(new_rows)) return false;
+        if (new_rows > 0) printWatches();
+    }
+}
+
+
+bool Table::addWatch(const std::string& stat, const unsigned int col) {
+    if (!checkValidColumn(col)) return false;
+    if (!checkNumericColumn(col)) return false;
+    std::string upper(stat);
+    for (auto& ch : upper) ch = std::toupper(ch);
+    if (upper != "MIN" && upper != "MAX" && upper != "AVERAGE" &&
+        upper != "COUNT" && upper != "MEDIAN") {
+        std::cout << "Unknown statistic: " << stat << "\n\n";
+        return false;
+    }
+    Watch watch;
+    watch.stat = upper;
+    watch.col = col;
+    // One scan over the existing rows, then only appended rows are added.
+    for (const auto val : getColumnValues(col)) watch.stats.add(val);
+    watches_.push_back(watch);
+    return true;
+}
+
+
+void Table::updateWatches(const unsigned int first_row) {
+    for (auto& watch : watches_) {
+        const Column& c = data_[watch.col];
+        if (!isNumeric(c)) continue; // Widened to STRING by new rows.
+        for (unsigned int row = first_row; row < num_rows_; row++)
+            if (testBit(c.valid, row)) watch.stats.add(cellValue(c, row));
+    }
+}
+
+
+// Deleting rows or converting a column cannot be undone in a running
+// statistic, so start over.
+void Table::rebuildWatches() {
+    for (auto& watch : watches_) {
+        watch.stats = RunningStats();
+        for (const auto val : getColumnValues(watch.col)) watch.stats.add(val);
+    }
+}
+
+
+bool Table::printWatches() const {
+    for (const auto& watch : watches_) {
+        std::cout << watch.stat << " " << headers_[watch.col] << ": ";
+        const RunningStats& stats = watch.stats;
+        if (watch.stat == "COUNT") std::cout << stats.count();
+        else if (stats.count() == 0) {} // No values yet, like MINCOLUMN.
+        else if (watch.stat == "MIN") std::cout << stats.min();
+        else if (watch.stat == "MAX") std::cout << stats.max();
+        else if (watch.stat == "AVERAGE") std::cout << stats.average();
+        else std::cout << stats.median();
+        std::cout << std::endl;
+    }
     return true;
 }
 
@@ -255,7 +1049,7 @@ bool Table::readCSV(const std::string& filename) {
 bool Table::printTable() const {
     printHeaders();
     // printRow takes int argument.
-    for (unsigned int row = 0; row < data_.size(); row++) printRow(row);
+    for (unsigned int row = 0; row < num_rows_; row++) printRow(row);
     std::cout << std::endl;
     return true;
 }
@@ -272,7 +1066,10 @@ bool Table::printColumn(const unsigned int col, const bool header_on) const {
     // Ideally justify to data_ width.
     if (!checkValidColumn(col)) return false;
     if (header_on) std::cout << headers_[col] << std::endl;
-    for (const auto& row : data_) std::cout << row[col] << std::endl;
+    for (unsigned int row = 0; row < num_rows_; row++) {
+        printCell(col, row);
+        std::cout << std::endl;
+    }
     return true;
 }
 
@@ -288,8 +1085,8 @@ bool Table::printColumns(const std::vector<std::string>& params,
         if (range.size() == 2) {
             unsigned int start = stoi(range[0]);
             unsigned int end = stoi(range[1]);
-            checkValidColumn(start);
-            checkValidColumn(end);
+            if (!checkValidColumn(start)) return false;
+            if (!checkValidColumn(end)) return false;
             for (unsigned int i = start; i <= end; i++)
                 cols.push_back(i);
         } else if (range.size() > 2) {
@@ -307,8 +1104,11 @@ bool Table::printColumns(const std::vector<std::string>& params,
         std::cout << std::endl;
     }
     // Print selected column data_.
-    for (const auto& row : data_) {
-        for (const auto& col : cols) std::cout << row[col] << ",";
+    for (unsigned int row = 0; row < num_rows_; row++) {
+        for (const auto& col : cols) {
+            printCell(col, row);
+            std::cout << ",";
+        }
         std::cout << std::endl;
     }
     return true;
@@ -321,14 +1121,30 @@ bool Table::printRow(const unsigned int row, const bool header_on) const {
         for (const auto& h : headers_) std:: cout << h << ",";
         std::cout << std::endl;
     }
-    for (const auto& cel : data_[row]) std::cout << cel << ",";
+    for (unsigned int col = 0; col < data_.size(); col++) {
+        printCell(col, row);
+        std::cout << ",";
+    }
     std::cout << std::endl;
     return true;
 }
 
 
+// Null cells print as empty, matching how they appear in the CSV input.
+void Table::printCell(const unsigned int col, const unsigned int row) const {
+    const Column& c = data_[col];
+    if (!testBit(c.valid, row)) return;
+    switch (c.type) {
+        case(INT64):   std::cout << c.i64[row]; break;
+        case(FLOAT32): std::cout << c.f32[row]; break;
+        case(FLOAT64): std::cout << c.f64[row]; break;
+        case(STRING):  std::cout << c.dictionary[c.codes[row]]; break;
+    }
+}
+
+
 bool Table::checkValidRow(const unsigned int row) const {
-    if (row >= data_.size()) {
+    if (row >= num_rows_) {
         std::cout << "Row out of range: " << row << std::endl;
         return false;
     }
@@ -345,26 +1161,51 @@ bool Table::checkValidColumn(const unsigned int col) const {
 }
 
 
-void Table::appendColumn(const std::string& col_name,
-                      const std::vector<double>& col_vals) {
+bool Table::checkNumericColumn(const unsigned int col) const {
+    if (!isNumeric(data_[col])) {
+        std::cout << "Col is not numeric: " << col << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+void Table::appendColumn(const std::string& col_name, Column col) {
     headers_.push_back(col_name);
-    for (unsigned int row = 0; row < data_.size(); row++)
-        data_[row].push_back(col_vals[row]);
+    data_.push_back(std::move(col));
+    file_fields_.push_back(-1); // Not in the CSV file.
 }
 
 
 bool Table::deleteColumn(const unsigned int col) {
     if (!checkValidColumn(col)) return false;
     headers_.erase(headers_.begin() + col);
-    for (auto& row : data_)
-        row.erase(row.begin() + col);
+    data_.erase(data_.begin() + col);
+    file_fields_.erase(file_fields_.begin() + col);
+    // Drop watches on the deleted column and renumber later ones.
+    for (unsigned int i = watches_.size(); i-- > 0;) {
+        if (watches_[i].col == col) watches_.erase(watches_.begin() + i);
+        else if (watches_[i].col > col) watches_[i].col--;
+    }
+    sketches_.clear();
     return true;
 }
 
 
 bool Table::deleteRow(const unsigned int row) {
     if (!checkValidRow(row)) return false;
-    data_.erase(data_.begin() + row);
+    for (auto& col : data_) eraseCell(col, num_rows_, row);
+    num_rows_--;
+    // A deleted provisional row is parsed again by REFRESH once its line is
+    // complete, like any appended row.
+    if (partial_row_ == int(row)) {
+        partial_row_ = -1;
+        partial_bytes_ = 0;
+    } else if (partial_row_ > int(row)) {
+        partial_row_--;
+    }
+    rebuildWatches();
+    sketches_.clear();
     return true;
 }
 
@@ -411,28 +1252,64 @@ void Table::joinMissingColumns(const Table& other,
     if (other_cols_to_join.empty()) return;
 
     // Map matching rows between Tables in a vector.
-    std::vector<int> this_to_other_row(this->data_.size(), -1);
-    for (unsigned int i = 0; i < other.data_.size(); i++) {
-        for (unsigned int j = 0; j < this->data_.size(); j++) {
-            if (this->data_[j][this_col] == other.data_[i][other_col]) {
-                this_to_other_row[j] = i;
-            }
-        }
-    }
+    std::vector<int> this_to_other_row;
+    std::vector<char> other_matched;
+    matchJoinRows(other, this_col, other_col, this_to_other_row, other_matched);
     // Append the new columns to all existing rows.
     for (auto col : other_cols_to_join) {
-        std::vector<double> other_col_vals(this->data_.size(), NAN);
-        for (unsigned int i = 0; i < this->data_.size(); i++) {
-            if (this_to_other_row[i] == -1) continue; // Default NaN.
-            other_col_vals[i] = other.data_[this_to_other_row[i]][col];
+        const Column& src = other.data_[col];
+        Column other_col_vals;
+        other_col_vals.type = src.type;
+        for (unsigned int i = 0; i < this->num_rows_; i++) {
+            int src_row = this_to_other_row[i];
+            if (src_row == -1) pushNull(other_col_vals, i); // Default null.
+            else copyCell(other_col_vals, i, src, src_row);
         }
-        this->appendColumn(other.headers_[col], other_col_vals);
+        this->appendColumn(other.headers_[col], std::move(other_col_vals));
+    }
+}
+
+
+// Matches rows on the join column by hashing the keys in their own type, so
+// integer and string keys compare exactly. Mixed number types are compared
+// as doubles; a string key never equals a number.
+void Table::matchJoinRows(const Table& other, const int this_col,
+                          const int other_col,
+                          std::vector<int>& this_to_other_row,
+                          std::vector<char>& other_matched) const {
+    const Column& a = this->data_[this_col];
+    const Column& b = other.data_[other_col];
+    this_to_other_row.assign(this->num_rows_, -1);
+    other_matched.assign(other.num_rows_, false);
+
+    if (a.type == INT64 && b.type == INT64) {
+        matchKeys(a.i64, a.valid, b.i64, b.valid, this_to_other_row, other_matched);
+    } else if (a.type == STRING && b.type == STRING) {
+        // Translate other's codes into this column's dictionary. Strings
+        // this column has never seen get a code it cannot hold.
+        const uint32_t NO_CODE = ~uint32_t(0);
+        std::vector<uint32_t> code_map(b.dictionary.size(), NO_CODE);
+        for (unsigned int i = 0; i < b.dictionary.size(); i++) {
+            auto found = a.lookup.find(b.dictionary[i]);
+            if (found != a.lookup.end()) code_map[i] = found->second;
+        }
+        std::vector<uint32_t> b_codes(b.codes.size(), NO_CODE);
+        for (unsigned int i = 0; i < b.codes.size(); i++)
+            if (testBit(b.valid, i)) b_codes[i] = code_map[b.codes[i]];
+        matchKeys(a.codes, a.valid, b_codes, b.valid,
+                  this_to_other_row, other_matched);
+    } else if (isNumeric(a) && isNumeric(b)) {
+        std::vector<double> a_keys(this->num_rows_), b_keys(other.num_rows_);
+        for (unsigned int i = 0; i < a_keys.size(); i++) a_keys[i] = cellValue(a, i);
+        for (unsigned int i = 0; i < b_keys.size(); i++) b_keys[i] = cellValue(b, i);
+        matchKeys(a_keys, a.valid, b_keys, b.valid,
+                  this_to_other_row, other_matched);
     }
 }
 
 
 bool Table::innerJoin(const Table& other, const std::string& join_col_name) {
-    if (headers_.empty() || data_.empty()) {
+    if (headers_.empty() || num_rows_ == 0) {
         std::cout << "No main table data loaded.\n";
         return false;
     }
@@ -448,7 +1325,7 @@ bool Table::innerJoin(const Table& other, const std::string& join_col_name) {
 
 
 bool Table::outerJoin(const Table& other, const std::string& join_col_name) {
-    if (headers_.empty() || data_.empty()) {
+    if (headers_.empty() || num_rows_ == 0) {
         std::cout << "No main table loaded.\n";
         return false;
     }
@@ -462,18 +1339,12 @@ bool Table::outerJoin(const Table& other, const std::string& join_col_name) {
 
 
     // Collect rows from other Table that are not in this Table.
-    // Sorting on the join column would speed this up.
+    std::vector<int> this_to_other_row;
+    std::vector<char> other_matched;
+    matchJoinRows(other, this_col, other_col, this_to_other_row, other_matched);
     std::vector<unsigned int> missing_other_rows;
-    for (unsigned int i = 0; i < other.data_.size(); i++) {
-        bool found_row = false;
-        for (unsigned int j = 0; j < this->data_.size(); j++) {
-            if (other.data_[i][other_col] == this->data_[j][this_col]) {
-                found_row = true;
-                break;
-            }
-        }
-        if (!found_row) missing_other_rows.push_back(i);
-    }
+    for (unsigned int i = 0; i < other.num_rows_; i++)
+        if (!other_matched[i]) missing_other_rows.push_back(i);
     // Check that there are rows in other to append.
     if (missing_other_rows.empty()) return true;
 
@@ -488,69 +1359,73 @@ bool Table::outerJoin(const Table& other, const std::string& join_col_name) {
     }
 
     // Append the new rows to existing Table.
+    unsigned int first_row = num_rows_;
     for (auto row : missing_other_rows) {
-        std::vector<double> new_row(this->headers_.size(), NAN);
         for (unsigned int col = 0; col < this->headers_.size(); col++) {
-            if (this_to_other_col[col] == -1) continue; // Default NaN.
-            new_row[col] = other.data_[row][this_to_other_col[col]];
+            if (this_to_other_col[col] == -1) { // Default null.
+                pushNull(this->data_[col], num_rows_);
+                continue;
+            }
+            copyCell(this->data_[col], num_rows_,
+                     other.data_[this_to_other_col[col]], row);
         }
-        this->data_.push_back(new_row);
+        num_rows_++;
     }
+    updateWatches(first_row);
     return true;
 }
 
 
-// Used by mathematical methods to gather numbers and exclude NaN values.
+// Used by mathematical methods to gather the values of non-null cells.
 std::vector<double> Table::getColumnValues(const unsigned int col) const {
     std::vector<double> vals;
-    for (const auto& row : data_) {
-        if (std::isnan(row[col])) continue; // Skip NaN cells.
-        vals.push_back(row[col]);
-    }
+    vals.reserve(countValid(col));
+    GatherValues gather = {data_[col].valid, vals};
+    visitNumeric(data_[col], gather);
     return vals;
 }
 
 
+// Number of non-null cells in a column.
+unsigned int Table::countValid(const unsigned int col) const {
+    unsigned int count = 0;
+    for (const auto bits : data_[col].valid) count += __builtin_popcountll(bits);
+    return count;
+}
+
+
 bool Table::printColumnMin(const unsigned int col) const {
     if (!checkValidColumn(col)) return false;
-    std::vector<double> vals = getColumnValues(col);
-    if (vals.empty()) return true;
+    if (!checkNumericColumn(col)) return false;
+    if (countValid(col) == 0) return true;
 
-    double min = vals[0];
-    for (const auto val : vals) {
-        if (val < min) min = val;
-    }
-    std::cout << min << std::endl;
+    PrintExtreme print_min = {data_[col].valid, false};
+    visitNumeric(data_[col], print_min);
     return true;
 }
 
 
 bool Table::printColumnMax(const unsigned int col) const {
     if (!checkValidColumn(col)) return false;
-    std::vector<double> vals = getColumnValues(col);
-    if (vals.empty()) return true;
+    if (!checkNumericColumn(col)) return false;
+    if (countValid(col) == 0) return true;
 
-    double max = vals[0];
-    for (const auto val : vals) {
-        if (val > max) max = val;
-    }
-    std::cout << max << std::endl;
+    PrintExtreme print_max = {data_[col].valid, true};
+    visitNumeric(data_[col], print_max);
     return true;
 }
 
 
 bool Table::printColumnAverage(const unsigned int col) const {
     if (!checkValidColumn(col)) return false;
-    double average = 0;
-    unsigned int count = 0;
-    for (const auto& row : data_) {
-        if (std::isnan(row[col])) continue; // Skip NaN cells.
-        average+=row[col];
-        count++;
-    }
+    if (!checkNumericColumn(col)) return false;
+    if (approximate_ && sample_percent_ < 100) return printSampledAverage(col);
+    unsigned int count = countValid(col);
     if (count == 0) return true; // No values to average.
 
-    average/=count;
+    SumValues sum = {data_[col].valid, 0.0};
+    visitNumeric(data_[col], sum);
+    double average = sum.sum / count;
     std::cout << average << std::endl;
     return true;
 }
@@ -558,7 +1433,13 @@ bool Table::printColumnAverage(const unsigned int col) const {
 
 bool Table::printColumnMedian(const unsigned int col) const {
     if (!checkValidColumn(col)) return false;
+    if (!checkNumericColumn(col)) return false;
+    if (approximate_) return printApproximateMedian(col);
     std::vector<double> vals = getColumnValues(col);
+    // NaN values have no place in an ordering, as for MIN and MAX.
+    vals.erase(std::remove_if(vals.begin(), vals.end(),
+                              [](double val) { return std::isnan(val); }),
+               vals.end());
     if (vals.empty()) return true;
 
     quickSort(vals);
@@ -573,13 +1454,11 @@ bool Table::printColumnMedian(const unsigned int col) const {
 bool Table::sumColumns(const unsigned int col1, const unsigned int col2) {
     if (!checkValidColumn(col1)) return false;
     if (!checkValidColumn(col2)) return false;
+    if (!checkNumericColumn(col1)) return false;
+    if (!checkNumericColumn(col2)) return false;
     std::string new_col_name = headers_[col1] + "_+_" + headers_[col2];
-    headers_.push_back(new_col_name);
-    for (auto& row : data_) {
-        if (std::isnan(row[col1]) || std::isnan(row[col2]))
-            row.push_back(NAN); // NaN for NaN operation cells.
-        else row.push_back(row[col1] + row[col2]);
-    }
+    appendColumn(new_col_name,
+                 combineColumns(data_[col1], data_[col2], AddCells()));
     return true;
 }
 
@@ -587,13 +1466,11 @@ bool Table::sumColumns(const unsigned int col1, const unsigned int col2) {
 bool Table::subtractColumns(const unsigned int col1, const unsigned int col2) {
     if (!checkValidColumn(col1)) return false;
     if (!checkValidColumn(col2)) return false;
+    if (!checkNumericColumn(col1)) return false;
+    if (!checkNumericColumn(col2)) return false;
     std::string new_col_name = headers_[col1] + "_-_" + headers_[col2];
-    headers_.push_back(new_col_name);
-    for (auto& row : data_) {
-        if (std::isnan(row[col1]) || std::isnan(row[col2]))
-            row.push_back(NAN); // NaN for NaN operation cells.
-        else row.push_back(row[col1] - row[col2]);
-    }
+    appendColumn(new_col_name,
+                 combineColumns(data_[col1], data_[col2], SubtractCells()));
     return true;
 }
 
@@ -601,13 +1478,11 @@ bool Table::subtractColumns(const unsigned int col1, const unsigned int col2) {
 bool Table::divideColumns(const unsigned int col1, const unsigned int col2) {
     if (!checkValidColumn(col1)) return false;
     if (!checkValidColumn(col2)) return false;
+    if (!checkNumericColumn(col1)) return false;
+    if (!checkNumericColumn(col2)) return false;
     std::string new_col_name = headers_[col1] + "_/_" + headers_[col2];
-    headers_.push_back(new_col_name);
-    for (auto& row : data_) {
-        if (std::isnan(row[col1]) || std::isnan(row[col2]))
-            row.push_back(NAN); // NaN for NaN operation cells.
-        else row.push_back(row[col1] / row[col2]);
-    }
+    appendColumn(new_col_name,
+                 combineColumns(data_[col1], data_[col2], DivideCells()));
     return true;
 }
 
@@ -615,12 +1490,173 @@ bool Table::divideColumns(const unsigned int col1, const unsigned int col2) {
 bool Table::multiplyColumns(const unsigned int col1, const unsigned int col2) {
     if (!checkValidColumn(col1)) return false;
     if (!checkValidColumn(col2)) return false;
+    if (!checkNumericColumn(col1)) return false;
+    if (!checkNumericColumn(col2)) return false;
     std::string new_col_name = headers_[col1] + "_*_" + headers_[col2];
-    headers_.push_back(new_col_name);
-    for (auto& row : data_) {
-        if (std::isnan(row[col1]) || std::isnan(row[col2]))
-            row.push_back(NAN); // NaN for NaN operation cells.
-        else row.push_back(row[col1] * row[col2]);
+    appendColumn(new_col_name,
+                 combineColumns(data_[col1], data_[col2], MultiplyCells()));
+    return true;
+}
+
+
+bool Table::setApproximate(const std::string& mode) {
+    std::string upper(mode);
+    for (auto& ch : upper) ch = std::toupper(ch);
+    if (upper == "ON") approximate_ = true;
+    else if (upper == "OFF") approximate_ = false;
+    else {
+        std::cout << "Bad parameters. Check help.\n\n";
+        return false;
+    }
+    return true;
+}
+
+
+bool Table::setSample(const unsigned int percent) {
+    if (percent == 0 || percent > 100) {
+        std::cout << "Sample percent out of range: " << percent << std::endl;
+        return false;
+    }
+    sample_percent_ = percent;
+    return true;
+}
+
+
+void Table::ColumnSketch::merge(const ColumnSketch& other) {
+    distinct.merge(other.distinct);
+    quantiles.merge(other.quantiles);
+}
+
+
+// Sketches a column from first_row on, reading percent of its blocks. Long
+// columns are split into chunks sketched on separate threads and merged.
+Table::ColumnSketch Table::buildSketch(const unsigned int col,
+                                       const unsigned int first_row,
+                                       const unsigned int percent) const {
+    const Column& c = data_[col];
+    const unsigned int w_begin = first_row / WORD_BITS;
+    const unsigned int w_end = c.valid.size();
+    const unsigned int chunk_words = SKETCH_CHUNK_ROWS / WORD_BITS;
+    const unsigned int num_chunks = std::max(1u, std::min(
+        (w_end - w_begin + chunk_words - 1) / chunk_words,
+        std::max(1u, std::thread::hardware_concurrency())));
+    const unsigned int words_per_chunk =
+        (w_end - w_begin + num_chunks - 1) / num_chunks;
+
+    std::vector<ColumnSketch> partial(num_chunks);
+    auto sketchChunk = [&](unsigned int chunk) {
+        ColumnSketch& sketch = partial[chunk];
+        sketch.quantiles = KllSketch(chunk + 1);
+        unsigned int begin = std::min(w_end, w_begin + chunk * words_per_chunk);
+        unsigned int end = std::min(w_end, begin + words_per_chunk);
+        SketchCells add = {c.valid, first_row, begin, end, percent,
+                           isNumeric(c), sketch.distinct, sketch.quantiles};
+        if (isNumeric(c)) visitNumeric(c, add);
+        else add(c.codes);
+    };
+    std::vector<std::thread> threads;
+    for (unsigned int chunk = 1; chunk < num_chunks; chunk++)
+        threads.emplace_back(sketchChunk, chunk);
+    sketchChunk(0);
+    for (auto& thread : threads) thread.join();
+
+    for (unsigned int chunk = 1; chunk < num_chunks; chunk++)
+        partial[0].merge(partial[chunk]);
+    partial[0].type = c.type;
+    partial[0].rows = num_rows_;
+    return partial[0];
+}
+
+
+// Whole column sketches are kept between queries. Rows appended since, ie.
+// by REFRESH, are sketched alone and merged in.
+const Table::ColumnSketch& Table::columnSketch(const unsigned int col) const {
+    auto found = sketches_.find(col);
+    if (found != sketches_.end() && found->second.type == data_[col].type) {
+        ColumnSketch& sketch = found->second;
+        if (sketch.rows < num_rows_) {
+            sketch.merge(buildSketch(col, sketch.rows, 100));
+            sketch.rows = num_rows_;
+        }
+        return sketch;
+    }
+    return sketches_[col] = buildSketch(col, 0, 100);
+}
+
+
+bool Table::printDistinctCount(const unsigned int col) const {
+    if (!checkValidColumn(col)) return false;
+    std::cout << std::llround(columnSketch(col).distinct.estimate()) << std::endl;
+    return true;
+}
+
+
+// Average over a block sample, with a 95% confidence bound.
+bool Table::printSampledAverage(const unsigned int col) const {
+    SampleSums sums = {data_[col].valid, sample_percent_, false, 0,
+                       0, 0, 0, 0, 0, 0};
+    visitNumeric(data_[col], sums);
+    if (sums.sum_n == 0 || sums.blocks < 2) { // Too small to sample.
+        SumValues sum = {data_[col].valid, 0.0};
+        visitNumeric(data_[col], sum);
+        unsigned int count = countValid(col);
+        if (count > 0) std::cout << sum.sum / count << " +/- 0" << std::endl;
+        return true;
+    }
+
+    double variance = sums.variance(data_[col].valid.size());
+    std::cout << sums.sum_y / sums.sum_n << " +/- "
+              << 1.96 * std::sqrt(variance) << std::endl;
+    return true;
+}
+
+
+// Median from a quantile sketch, with the values at the edges of its rank
+// error as bounds. A sampled median adds the sampling error of the rank.
+// Rows are sampled in blocks, and neighbouring rows are often alike, so that
+// error comes from the spread between blocks: the share of values at or
+// below the median is a ratio estimate like the sampled average (Woodruff,
+// 1952).
+bool Table::printApproximateMedian(const unsigned int col) const {
+    ColumnSketch sampled;
+    if (sample_percent_ < 100) sampled = buildSketch(col, 0, sample_percent_);
+    const ColumnSketch& sketch = (sample_percent_ < 100) ?
+                                 sampled : columnSketch(col);
+    const KllSketch& quantiles = sketch.quantiles;
+    if (quantiles.count() == 0) return true;
+
+    double error = quantiles.rankError();
+    if (sample_percent_ < 100) {
+        SampleSums below = {data_[col].valid, sample_percent_, true,
+                            quantiles.quantile(0.5), 0, 0, 0, 0, 0, 0};
+        visitNumeric(data_[col], below);
+        // A single block says nothing about the spread, so the bounds are
+        // the whole sample.
+        error += (below.blocks < 2) ? 0.5 :
+                 1.96 * std::sqrt(below.variance(data_[col].valid.size()));
+    }
+    std::cout << quantiles.quantile(0.5) << " [" << quantiles.quantile(0.5 - error)
+              << ", " << quantiles.quantile(0.5 + error) << "]" << std::endl;
+    return true;
+}
+
+
+// Appends a column of a statistic over the trailing window of rows ending
+// at each row, ie. a moving average. One pass per chunk of rows.
+bool Table::rollingColumn(const std::string& stat, const unsigned int col,
+                          const unsigned int window) {
+    if (!checkValidColumn(col)) return false;
+    if (!checkNumericColumn(col)) return false;
+    if (window == 0) {
+        std::cout << "Window out of range: " << window << std::endl;
+        return false;
     }
+    std::string lower_stat(stat);
+    for (auto& ch : lower_stat) ch = std::tolower(ch);
+    std::string new_col_name = headers_[col] + "_rolling" + lower_stat + "_" +
+                               std::to_string(window);
+    RollingWindow rolling = {data_[col].valid, window, stat, Column()};
+    visitNumeric(data_[col], rolling);
+    appendColumn(new_col_name, std::move(rolling.result));
     return true;
 }
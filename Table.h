@@ -1,7 +1,11 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include <unordered_map>
 #include <vector>
+#include "Column.h"
+#include "RunningStats.h"
+#include "Sketch.h"
 
 
 std::vector<std::string> split(const std::string &str, char delim);
@@ -17,9 +21,60 @@ public:
     bool readCSV(const std::string& filename);
 
 private:
+    // A column statistic kept up to date as rows are appended.
+    struct Watch {
+        std::string stat; // MIN, MAX, AVERAGE, COUNT or MEDIAN.
+        unsigned int col;
+        RunningStats stats;
+    };
+
+    // Sketches of one column, cached for approximate queries.
+    struct ColumnSketch {
+        ColumnType type; // Cells hash differently once a column widens.
+        unsigned int rows; // Rows covered; later rows are appended ones.
+        HyperLogLog distinct;
+        KllSketch quantiles;
+        void merge(const ColumnSketch& other);
+    };
+
     std::string name_;
     std::vector<std::string> headers_;
-    std::vector<std::vector<double>> data_;
+    std::vector<Column> data_; // Column-major, one entry per header.
+    std::vector<int> file_fields_; // CSV field of each column, -1 if added.
+    unsigned int num_rows_ = 0;
+    std::streamoff read_offset_ = 0; // Bytes of name_ in complete lines.
+    // A last line without a newline is parsed at load as a provisional row,
+    // which REFRESH replaces once the writer finishes the line.
+    int partial_row_ = -1;
+    std::streamoff partial_bytes_ = 0;
+    // Likewise a header line without a newline, checked once it completes.
+    std::string partial_header_;
+    bool sharded_ = false; // Loaded from several files; cannot be followed.
+    std::unordered_map<std::string, ColumnType> schema_; // SCHEMA overrides.
+    std::vector<Watch> watches_;
+    bool approximate_ = false;
+    unsigned int sample_percent_ = 100; // Rows read by approximate queries.
+    mutable std::unordered_map<unsigned int, ColumnSketch> sketches_;
+
+    // Loading one or many CSV files.
+    bool readCSVFile(const std::string& filename,
+                     std::vector<ColumnType> types = {});
+    std::vector<ColumnType> inferSchema(std::istream& csv_file,
+                                        const std::vector<std::string>& headers) const;
+    bool setSchema(const std::vector<std::string>& params);
+    bool printSchema() const;
+    bool readCSVShards(const std::vector<std::string>& filenames);
+
+    // Follow mode for CSV files that are appended to.
+    std::streamoff readRows(std::istream& csv_file, const bool complete_only);
+    void parseRow(const std::string& line);
+    bool refreshCSV(unsigned int& new_rows);
+    bool refreshCSV();
+    bool followCSV(const unsigned int interval);
+    bool addWatch(const std::string& stat, const unsigned int col);
+    void updateWatches(const unsigned int first_row);
+    void rebuildWatches();
+    bool printWatches() const;
 
     // Display methods
     bool printTable() const;
@@ -28,24 +83,28 @@ private:
     bool printColumns(const std::vector<std::string>& params,
                       const bool header_on=true) const;
     bool printRow(const unsigned int row, const bool header_on=false) const;
+    void printCell(const unsigned int col, const unsigned int row) const;
 
     // Table operations
     bool printNumColumns() const { std::cout << headers_.size() << std::endl; 
                                    return true; }
-    bool printNumRows() const { std::cout << data_.size() << std::endl;
+    bool printNumRows() const { std::cout << num_rows_ << std::endl;
                                 return true; }
 
     bool checkValidRow(const unsigned int row) const;
     bool checkValidColumn(const unsigned int col) const;
+    bool checkNumericColumn(const unsigned int col) const;
 
-    void appendColumn(const std::string& col_name,
-                      const std::vector<double>& col_vals);
+    void appendColumn(const std::string& col_name, Column col);
     bool deleteColumn(const unsigned int col);
     bool deleteRow(const unsigned int row);
 
     bool findMatchingColumn(const Table& other,
                             const std::string& join_col_name,
                             int& this_col, int& other_col) const;
+    void matchJoinRows(const Table& other, const int this_col, const int other_col,
+                       std::vector<int>& this_to_other_row,
+                       std::vector<char>& other_matched) const;
     void joinMissingColumns(const Table& other, int& this_col, int& other_col);
     bool innerJoin(const Table& other, const std::string& join_col_name);
     bool outerJoin(const Table& other, const std::string& join_col_name);
@@ -56,9 +115,22 @@ private:
     bool printColumnMax(const unsigned int col) const;
     bool printColumnAverage(const unsigned int col) const;
     bool printColumnMedian(const unsigned int col) const;
+    unsigned int countValid(const unsigned int col) const;
 
     bool sumColumns(const unsigned int col1, const unsigned int col2);
     bool subtractColumns(const unsigned int col1, const unsigned int col2);
     bool divideColumns(const unsigned int col1, const unsigned int col2);
     bool multiplyColumns(const unsigned int col1, const unsigned int col2);
+    bool rollingColumn(const std::string& stat, const unsigned int col,
+                       const unsigned int window);
+
+    // Approximate queries
+    bool setApproximate(const std::string& mode);
+    bool setSample(const unsigned int percent);
+    ColumnSketch buildSketch(const unsigned int col, const unsigned int first_row,
+                             const unsigned int percent) const;
+    const ColumnSketch& columnSketch(const unsigned int col) const;
+    bool printDistinctCount(const unsigned int col) const;
+    bool printSampledAverage(const unsigned int col) const;
+    bool printApproximateMedian(const unsigned int col) const;
 };